@@ -5,11 +5,19 @@
 #include <cstdio>
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/file.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
 #include <iomanip>
 #include <openssl/sha.h>
 #include <vector>
 #include <unordered_map>
 #include <set>
+#include <map>
+#include <algorithm>
 #include <zlib.h>
 using namespace std;
 using namespace std::filesystem;
@@ -167,29 +175,67 @@ void hashObject(const string& file, bool store){
     }
 }
 
+//single line of a tree object
+struct TreeEntry{
+    string mode;
+    string type;
+    string hash;
+    string name;
+};
+
+//drops empty and "." components so index paths and tree names compare equal
+string normalizePath(const string& filePath){
+    string normalized;
+    size_t start = 0;
+    while(start <= filePath.size()){
+        size_t slash = filePath.find('/', start);
+        if(slash == string::npos){
+            slash = filePath.size();
+        }
+        string component = filePath.substr(start, slash - start);
+        if(!component.empty() && component != "."){
+            normalized += (normalized.empty() ? "" : "/") + component;
+        }
+        start = slash + 1;
+    }
+    return normalized;
+}
+
+//writes the entries sorted by name as a tree object and returns its hash value
+string serializeTree(vector<TreeEntry> entries){
+    sort(entries.begin(), entries.end(), [](const TreeEntry& a, const TreeEntry& b){
+        return a.name < b.name;
+    });
+    ostringstream treeContent;
+    for(const TreeEntry& entry: entries){
+        treeContent << entry.mode << " " << entry.type << " " << entry.hash << " " << entry.name << "\n";
+    }
+    string treeData = treeContent.str();
+    string treeHash = SHA1(treeData);
+    string treePath = ".mygit/objects/objects" + treeHash.substr(0,2) + "/" + treeHash.substr(2);
+    if(!exists(treePath)){
+        string compressedFile = compressFile(treeData);
+        writeObject(treeHash, compressedFile);
+    }
+    return treeHash;
+}
+
 //creating a tree object of the current working directory and returning its hash value
 string createTreeObj(path directoryPath){
-    ostringstream treeContent;
+    vector<TreeEntry> entries;
     for(const auto &entry: directory_iterator(directoryPath)){
         if(is_regular_file(entry)){
             string fileHash = handleBlob(entry.path().string(), false);
-            treeContent << "100644 blob " << fileHash << " " << entry.path().filename().string() << "\n";
+            entries.push_back({"100644", "blob", fileHash, entry.path().filename().string()});
         }
         else if(is_directory(entry) && entry.path().filename() != ".mygit"){
             string treeHash = createTreeObj(entry.path());
             if(!treeHash.empty()){
-                treeContent << "040000 tree " << treeHash << " " << entry.path().filename().string() << "\n";
+                entries.push_back({"040000", "tree", treeHash, entry.path().filename().string()});
             }   
         }
     }
-    string treeData = treeContent.str();
-    string treeHash = SHA1(treeData);
-    string treePath = ".mygit/objects/objects" + treeHash.substr(0,2) + "/" + treeHash.substr(2);
-    if(!exists(treePath)){
-        string compressedFile = compressFile(treeData);
-        writeObject(treeHash, compressedFile);
-    }
-    return treeHash;
+    return serializeTree(entries);
 }
 
 //printing the hash value of the current working directory tree and calling a function to write the tree object
@@ -222,6 +268,179 @@ string readObject(const string& hash){
     return decompressFile(compressedData);
 }
 
+//parses one "mode type hash name" line of a tree object
+bool parseTreeLine(const string& line, TreeEntry& entry){
+    istringstream lineStream(line);
+    return static_cast<bool>(lineStream >> entry.mode >> entry.type >> entry.hash >> entry.name);
+}
+
+/*returns true for flat trees written by older commits, which store the whole "./" prefixed path as the name
+  these are neither nested nor sorted, so they are parsed completely instead of binary searched*/
+bool isFlatTree(const string& treeData){
+    TreeEntry entry;
+    return parseTreeLine(treeData.substr(0, treeData.find('\n')), entry) && entry.name.compare(0, 2, "./") == 0;
+}
+
+//parses all entries of a tree object, sorted by name
+vector<TreeEntry> parseTree(const string& treeData){
+    vector<TreeEntry> entries;
+    istringstream treeStream(treeData);
+    string line;
+    while(getline(treeStream, line)){
+        TreeEntry entry;
+        if(parseTreeLine(line, entry)){
+            entry.name = normalizePath(entry.name);
+            entries.push_back(entry);
+        }
+    }
+    auto byName = [](const TreeEntry& a, const TreeEntry& b){
+        return a.name < b.name;
+    };
+    if(!is_sorted(entries.begin(), entries.end(), byName)){
+        sort(entries.begin(), entries.end(), byName);
+    }
+    return entries;
+}
+
+//reads a tree object into its entries
+vector<TreeEntry> readTree(const string& treeHash){
+    return parseTree(readObject(treeHash));
+}
+
+//binary searches parsed tree entries for an entry with the given name
+const TreeEntry* lookupEntry(const vector<TreeEntry>& entries, const string& name){
+    auto it = lower_bound(entries.begin(), entries.end(), name, [](const TreeEntry& entry, const string& key){
+        return entry.name < key;
+    });
+    if(it == entries.end() || it->name != name){
+        return nullptr;
+    }
+    return &*it;
+}
+
+//returns true if the names of a tree object are in sorted order, which older versions of write-tree did not ensure
+bool isSortedTree(const string& treeData){
+    string_view previous;
+    size_t lineStart = 0;
+    while(lineStart < treeData.size()){
+        size_t lineEnd = treeData.find('\n', lineStart);
+        if(lineEnd == string::npos){
+            lineEnd = treeData.size();
+        }
+        string_view line(treeData.data() + lineStart, lineEnd - lineStart);
+        size_t nameStart = 0;
+        for(int i=0; i<3 && nameStart != string_view::npos; i++){
+            nameStart = line.find(' ', nameStart);
+            if(nameStart != string_view::npos){
+                nameStart++;
+            }
+        }
+        string_view name = nameStart == string_view::npos ? line : line.substr(nameStart);
+        if(lineStart > 0 && name < previous){
+            return false;
+        }
+        previous = name;
+        lineStart = lineEnd + 1;
+    }
+    return true;
+}
+
+//looks up a name in a tree object that cannot be binary searched by parsing all of its entries
+bool findUnsortedTreeEntry(const string& treeData, const string& name, TreeEntry& found){
+    vector<TreeEntry> entries = parseTree(treeData);
+    const TreeEntry* entry = lookupEntry(entries, name);
+    if(entry == nullptr){
+        return false;
+    }
+    found = *entry;
+    return true;
+}
+
+/*binary searches the sorted lines of a tree object for an entry with the given name
+  only the probed lines are parsed, each probe moves back to the start of the line it landed in
+  names are unique within a tree, so a hit is always correct, while a miss is only trusted once
+  the tree is known to be sorted and unsorted trees from older versions are parsed completely*/
+bool findTreeEntry(const string& treeData, const string& name, TreeEntry& found){
+    if(isFlatTree(treeData)){
+        return findUnsortedTreeEntry(treeData, name, found);
+    }
+    size_t low = 0, high = treeData.size();
+    while(low < high){
+        size_t lineStart = low + (high - low) / 2;
+        while(lineStart > low && treeData[lineStart - 1] != '\n'){
+            lineStart--;
+        }
+        size_t lineEnd = treeData.find('\n', lineStart);
+        if(lineEnd == string::npos){
+            lineEnd = treeData.size();
+        }
+        TreeEntry entry;
+        if(!parseTreeLine(treeData.substr(lineStart, lineEnd - lineStart), entry)){
+            break;
+        }
+        if(entry.name == name){
+            found = entry;
+            return true;
+        }
+        if(entry.name < name){
+            low = lineEnd + 1;
+        }
+        else{
+            high = lineStart;
+        }
+    }
+    return !isSortedTree(treeData) && findUnsortedTreeEntry(treeData, name, found);
+}
+
+/*finds a path in a flat tree from an older commit
+  a directory has no tree object there, so its children are the entries below it with the directory stripped*/
+bool lookupFlatPath(const vector<TreeEntry>& entries, const string& filePath, TreeEntry& found, vector<TreeEntry>& children){
+    const TreeEntry* entry = lookupEntry(entries, filePath);
+    if(entry != nullptr){
+        found = *entry;
+        return true;
+    }
+    string dirPrefix = filePath + "/";
+    auto it = lower_bound(entries.begin(), entries.end(), dirPrefix, [](const TreeEntry& entry, const string& key){
+        return entry.name < key;
+    });
+    for(; it != entries.end() && it->name.compare(0, dirPrefix.size(), dirPrefix) == 0; it++){
+        children.push_back({it->mode, it->type, it->hash, it->name.substr(dirPrefix.size())});
+    }
+    if(children.empty()){
+        return false;
+    }
+    found = {"040000", "tree", "", filePath};
+    return true;
+}
+
+/*finds the entry for a relative path by binary searching one tree level per path component
+  if the entry is a tree, its entries are returned in children
+  an empty path resolves to the tree itself*/
+bool lookupPath(const string& treeHash, const string& filePath, TreeEntry& found, vector<TreeEntry>& children){
+    found = {"040000", "tree", treeHash, ""};
+    children.clear();
+    string rest = normalizePath(filePath);
+    while(!rest.empty()){
+        if(found.type != "tree"){
+            return false;
+        }
+        string treeData = readObject(found.hash);
+        if(isFlatTree(treeData)){
+            return lookupFlatPath(parseTree(treeData), rest, found, children);
+        }
+        size_t slash = rest.find('/');
+        if(!findTreeEntry(treeData, rest.substr(0, slash), found)){
+            return false;
+        }
+        rest = slash == string::npos ? "" : rest.substr(slash + 1);
+    }
+    if(found.type == "tree"){
+        children = readTree(found.hash);
+    }
+    return true;
+}
+
 //returns the type of an object by reading the file contents
 string findType(const string& fileData){
     if(fileData.find("blob") != string::npos || fileData.find("tree") != string::npos){
@@ -260,27 +479,50 @@ void catFile(const string& flag, const string& hash){
     }
 }
 
-//reads the tree contents from its hash value and prints it
-void lsTree(const string& hash, bool name){
-    string treeData = readObject(hash);
-    if(treeData.empty()){
-        cout << "Tree is empty\n";
+//prints a tree entry, prefixing its name with the path of the tree it was found in
+void printTreeEntry(const TreeEntry& entry, const string& prefix, bool name){
+    string entryPath = prefix.empty() ? entry.name : prefix + "/" + entry.name;
+    if(name){
+        cout << entryPath << "\n";
     }
-    istringstream treeDataStream(treeData);
-    string line;
-    while(getline(treeDataStream, line)){
-        istringstream linestream(line);
-        string mode, type, objecthash, objectname;
-        linestream >> mode >> type >> objecthash >> objectname;
-        if(name){
-            cout << objectname << "\n";
+    else{
+        cout << entry.mode << " " << entry.type << " " << entry.hash << " " << entryPath << "\n";
+    }
+}
+
+//prints the entries of a tree, descending into subtrees and printing only blobs if recursive
+void listTreeEntries(const vector<TreeEntry>& entries, const string& prefix, bool name, bool recursive){
+    for(const TreeEntry& entry: entries){
+        if(recursive && entry.type == "tree"){
+            listTreeEntries(readTree(entry.hash), prefix.empty() ? entry.name : prefix + "/" + entry.name, name, recursive);
         }
-        else{            
-            cout << mode << " " << type << " " << objecthash << " " << objectname << "\n";
+        else{
+            printTreeEntry(entry, prefix, name);
         }
     }
 }
 
+/*reads the tree contents from its hash value and prints it
+  if a path is given, only the entry or subtree at that path is printed*/
+void lsTree(const string& hash, bool name, bool recursive, const string& filePath){
+    TreeEntry entry;
+    vector<TreeEntry> entries;
+    if(!lookupPath(hash, filePath, entry, entries)){
+        cout << "Path not found in tree\n";
+        exit(0);
+    }
+    string entryPath = normalizePath(filePath);
+    if(entry.type == "blob"){
+        entry.name = entryPath;
+        printTreeEntry(entry, "", name);
+        return;
+    }
+    if(entries.empty()){
+        cout << "Tree is empty\n";
+    }
+    listTreeEntries(entries, entryPath, name, recursive);
+}
+
 //writing to index file 
 void updateIndex(const unordered_map<string, pair<string, pair<string,string>>>& indexFiles){
     ofstream indexFile(".mygit/index", ios::trunc);
@@ -392,21 +634,46 @@ string prevTree(const string& parentHash){
     return treeHash;
 }
 
-//creates a commit tree with the contents from parent tree excluding the staged index files
-void createCommitTree(const string& prevTreeHash, ostringstream& treeData, set<string>& stagedFiles){
+/*creates a commit tree with the contents from parent tree, replaced by the staged index files
+  staged paths are relative to this tree and only the subtrees containing them are rewritten,
+  every other subtree keeps the hash from the parent tree*/
+string createCommitTree(const string& prevTreeHash, const map<string, TreeEntry>& stagedFiles){
+    map<string, TreeEntry> children;
+    map<string, TreeEntry> pending = stagedFiles;
     if(!prevTreeHash.empty()){
-        string prevTreeData = readObject(prevTreeHash);
-        istringstream prevTreeStream(prevTreeData);
-        string line;
-        while(getline(prevTreeStream, line)){
-            istringstream lineStream(line);
-            string mode, type, hash, path;
-            lineStream >> mode >> type >> hash >> path;
-            if(stagedFiles.find(path) == stagedFiles.end()){
-                treeData << mode << " " << type << " " << hash << " " << path << "\n";
+        for(const TreeEntry& entry: readTree(prevTreeHash)){
+            if(entry.name.find('/') != string::npos){
+                //flat trees from older commits are nested again, staged files take precedence
+                pending.insert({entry.name, entry});
+            }
+            else{
+                children[entry.name] = entry;
             }
         }
     }
+    map<string, map<string, TreeEntry>> subtreeFiles;
+    for(const auto& [filePath, entry]: pending){
+        size_t slash = filePath.find('/');
+        if(slash == string::npos){
+            children[filePath] = {entry.mode, entry.type, entry.hash, filePath};
+        }
+        else{
+            subtreeFiles[filePath.substr(0, slash)][filePath.substr(slash + 1)] = entry;
+        }
+    }
+    for(const auto& [dirName, files]: subtreeFiles){
+        string prevSubtree;
+        auto it = children.find(dirName);
+        if(it != children.end() && it->second.type == "tree"){
+            prevSubtree = it->second.hash;
+        }
+        children[dirName] = {"040000", "tree", createCommitTree(prevSubtree, files), dirName};
+    }
+    vector<TreeEntry> entries;
+    for(const auto& [entryName, entry]: children){
+        entries.push_back(entry);
+    }
+    return serializeTree(entries);
 }
 
 //creates a commit object if there are any staged files in index
@@ -421,35 +688,25 @@ void commit(const string& message){
     string parentHash = parentCommit();
     string prevTreeHash = prevTree(parentHash);
     
-    set<string> stagedFiles;
-    ostringstream indexData;
+    map<string, TreeEntry> stagedFiles;
 
     string mode, type;
     string filePath;
     string fileHash;
 
-    //stores the staged index files in a set
+    //stores the staged index files in a map keyed by their path
     while(indexFile >> mode >> type >> fileHash >> filePath){
-        stagedFiles.insert(filePath);
-        indexData << mode << " " << type << " " << fileHash << " " << filePath << "\n";
+        filePath = normalizePath(filePath);
+        stagedFiles[filePath] = {mode, type, fileHash, filePath};
     }
 
-    ostringstream treeData;
-
-    //creates commit tree by combining files from parent tree
-    createCommitTree(prevTreeHash, treeData, stagedFiles);
-    //adds the staged index files to the tree
-    treeData << indexData.str();
+    //creates commit tree by combining files from parent tree with the staged index files
+    string treeHash = createCommitTree(prevTreeHash, stagedFiles);
 
     //erases the index file after committing
     ofstream eraseIndexFile(".mygit/index", ios::out);
     eraseIndexFile.close();
 
-    string treeEntry = treeData.str();
-    string treeHash = SHA1(treeEntry);
-    string compressedTree = compressFile(treeEntry);
-    writeObject(treeHash, compressedTree);
-
     auto currTime = chrono::system_clock::now();
     time_t timestamp = chrono::system_clock::to_time_t(currTime);
     
@@ -537,34 +794,490 @@ void log(){
     }
 }
 
+//returns the value of a key in .mygit/config, stored as "key = value" lines
+string readConfig(const string& key, const string& defaultValue){
+    ifstream configFile(".mygit/config");
+    string line;
+    while(getline(configFile, line)){
+        size_t equals = line.find('=');
+        if(equals == string::npos){
+            continue;
+        }
+        string lineKey = line.substr(0, equals);
+        string value = line.substr(equals + 1);
+        lineKey.erase(lineKey.find_last_not_of(" \t") + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+        if(lineKey == key){
+            return value;
+        }
+    }
+    return defaultValue;
+}
+
+//prints the value of a key in .mygit/config, or sets it if a value is given
+void config(const string& key, const string& value, bool assign){
+    if(!exists(".mygit")){
+        cout << ".mygit does not exist\n";
+        exit(0);
+    }
+    if(!assign){
+        cout << readConfig(key, "") << "\n";
+        return;
+    }
+    vector<string> lines;
+    ifstream configFile(".mygit/config");
+    string line;
+    while(getline(configFile, line)){
+        size_t equals = line.find('=');
+        string lineKey = line.substr(0, equals);
+        lineKey.erase(lineKey.find_last_not_of(" \t") + 1);
+        if(lineKey != key){
+            lines.push_back(line);
+        }
+    }
+    configFile.close();
+    lines.push_back(key + " = " + value);
+    ofstream out(".mygit/config", ios::trunc);
+    if(!out.is_open()){
+        cout << "Cannot write to config file\n";
+        exit(0);
+    }
+    for(const string& configLine: lines){
+        out << configLine << "\n";
+    }
+    out.close();
+}
+
+//settings of the uncompressed blob cache in .mygit/cache, read once from .mygit/config
+struct BlobCacheSettings{
+    bool enabled;
+    bool hardlink;
+    uintmax_t maxSize;
+};
+
+const BlobCacheSettings& blobCacheSettings(){
+    static BlobCacheSettings settings = [](){
+        BlobCacheSettings loaded;
+        loaded.enabled = readConfig("cache.enabled", "false") == "true";
+        loaded.hardlink = readConfig("cache.hardlink", "false") == "true";
+        try{
+            loaded.maxSize = stoull(readConfig("cache.maxSize", "268435456"));
+        }
+        catch(const exception& e){
+            loaded.maxSize = 268435456;
+        }
+        //permissions do not stop root from writing through a hardlink into the cache
+        if(loaded.enabled && loaded.hardlink && geteuid() == 0){
+            cerr << "cache.hardlink is ignored when running as root, files are copied instead\n";
+            loaded.hardlink = false;
+        }
+        return loaded;
+    }();
+    return settings;
+}
+
+//size and modification time recorded when a blob was cached, and the checkout that last used it
+struct CachedBlob{
+    uintmax_t size;
+    long long mtime;
+    unsigned long long lastUse;
+};
+
+/*index of the uncompressed blob cache, loaded once from .mygit/cache/index
+  usage is tracked here rather than in the file times, since checked out files may share the inode
+  .mygit/cache/lock is held from loading the index until it is saved, so concurrent checkouts take turns*/
+struct BlobCacheIndex{
+    map<string, CachedBlob> blobs;
+    set<pair<unsigned long long, string>> byLastUse;
+    uintmax_t totalSize = 0;
+    unsigned long long currentUse = 1;
+    int lockFd = -1;
+};
+
+long long modifiedTime(const struct stat& st){
+    return (long long)st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+string cachePathOf(const string& hash){
+    return ".mygit/cache/" + hash.substr(0,2) + "/" + hash.substr(2);
+}
+
+BlobCacheIndex& blobCacheIndex(){
+    static BlobCacheIndex index = [](){
+        BlobCacheIndex loaded;
+        error_code ec;
+        create_directories(".mygit/cache", ec);
+        loaded.lockFd = open(".mygit/cache/lock", O_RDWR | O_CREAT, 0666);
+        if(loaded.lockFd >= 0){
+            flock(loaded.lockFd, LOCK_EX);
+        }
+        map<string, CachedBlob> indexed;
+        ifstream indexFile(".mygit/cache/index");
+        string hash;
+        CachedBlob blob;
+        while(indexFile >> hash >> blob.size >> blob.mtime >> blob.lastUse){
+            indexed[hash] = blob;
+        }
+        //blobs cached by a checkout that stopped before saving the index, and leftover temporary files, are removed
+        vector<path> orphans;
+        for(const auto& entry: recursive_directory_iterator(".mygit/cache", ec)){
+            if(!entry.is_regular_file()){
+                continue;
+            }
+            string fileName = entry.path().filename().string();
+            if(entry.path().parent_path() == path(".mygit/cache")){
+                if(fileName != "index" && fileName != "lock"){
+                    orphans.push_back(entry.path());
+                }
+                continue;
+            }
+            hash = entry.path().parent_path().filename().string() + fileName;
+            auto it = indexed.find(hash);
+            if(it == indexed.end()){
+                orphans.push_back(entry.path());
+                continue;
+            }
+            //only blobs that are still on disk are kept in the index
+            loaded.blobs[hash] = it->second;
+            loaded.byLastUse.insert({it->second.lastUse, hash});
+            loaded.totalSize += it->second.size;
+            loaded.currentUse = max(loaded.currentUse, it->second.lastUse + 1);
+        }
+        for(const path& orphan: orphans){
+            remove(orphan, ec);
+        }
+        return loaded;
+    }();
+    return index;
+}
+
+//removes a blob from the cache and its index
+void dropCachedBlob(const string& hash){
+    BlobCacheIndex& index = blobCacheIndex();
+    auto it = index.blobs.find(hash);
+    if(it == index.blobs.end()){
+        return;
+    }
+    unlink(cachePathOf(hash).c_str());
+    index.totalSize -= it->second.size;
+    index.byLastUse.erase({it->second.lastUse, hash});
+    index.blobs.erase(it);
+}
+
+/*evicts the least recently used blobs until a blob of the given size fits within cache.maxSize
+  blobs used by the current or the previous checkout are kept,
+  so repeated checkouts of a tree larger than the cap do not keep replacing the cached blobs
+  returns false if there is no room left*/
+bool makeCacheRoom(uintmax_t size){
+    BlobCacheIndex& index = blobCacheIndex();
+    uintmax_t maxSize = blobCacheSettings().maxSize;
+    if(size > maxSize){
+        return false;
+    }
+    while(index.totalSize + size > maxSize){
+        if(index.byLastUse.empty() || index.byLastUse.begin()->first + 1 >= index.currentUse){
+            return false;
+        }
+        dropCachedBlob(index.byLastUse.begin()->second);
+    }
+    return true;
+}
+
+/*returns the path of the uncompressed blob in .mygit/cache, decompressing it into the cache on a miss
+  a cached blob whose size or modification time changed was written through a hardlink and is dropped
+  returns an empty string if the blob is not cached, fileData is then set if the blob was already decompressed*/
+string cachedBlob(const string& hash, string& fileData, bool& inflated){
+    BlobCacheIndex& index = blobCacheIndex();
+    string cachePath = cachePathOf(hash);
+    auto it = index.blobs.find(hash);
+    if(it != index.blobs.end()){
+        struct stat st;
+        if(stat(cachePath.c_str(), &st) == 0 && (uintmax_t)st.st_size == it->second.size && modifiedTime(st) == it->second.mtime){
+            index.byLastUse.erase({it->second.lastUse, hash});
+            it->second.lastUse = index.currentUse;
+            index.byLastUse.insert({it->second.lastUse, hash});
+            return cachePath;
+        }
+        dropCachedBlob(hash);
+    }
+    fileData = readObject(hash);
+    inflated = true;
+    if(!makeCacheRoom(fileData.size())){
+        return "";
+    }
+    error_code ec;
+    create_directories(path(cachePath).parent_path(), ec);
+    //written to a temporary file first so that an interrupted checkout never leaves a partial blob
+    string tmpPath = cachePath + ".tmp" + to_string(getpid());
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if(fd < 0){
+        return "";
+    }
+    ssize_t bytesWritten = write(fd, fileData.c_str(), fileData.size());
+    close(fd);
+    if(bytesWritten != (ssize_t)fileData.size()){
+        remove(tmpPath.c_str());
+        return "";
+    }
+    //cached blobs are read-only since checked out files may share their inode
+    chmod(tmpPath.c_str(), S_IRUSR | S_IRGRP | S_IROTH);
+    struct stat st;
+    if(stat(tmpPath.c_str(), &st) != 0 || rename(tmpPath.c_str(), cachePath.c_str()) != 0){
+        remove(tmpPath.c_str());
+        return "";
+    }
+    index.blobs[hash] = {fileData.size(), modifiedTime(st), index.currentUse};
+    index.byLastUse.insert({index.currentUse, hash});
+    index.totalSize += fileData.size();
+    return cachePath;
+}
+
+/*creates a file from a cached blob, trying a read-only hardlink if enabled, then a reflink,
+  then copy_file_range and finally normal writes on filesystems that support neither*/
+bool checkoutCachedBlob(const string& hash, const string& filePath, string& fileData, bool& inflated){
+    string cachePath = cachedBlob(hash, fileData, inflated);
+    if(cachePath.empty()){
+        return false;
+    }
+    //the old file is unlinked so that a hardlinked file never gets written through to the cache
+    unlink(filePath.c_str());
+    if(blobCacheSettings().hardlink && link(cachePath.c_str(), filePath.c_str()) == 0){
+        return true;
+    }
+    int in = open(cachePath.c_str(), O_RDONLY);
+    if(in < 0){
+        return false;
+    }
+    struct stat st;
+    if(fstat(in, &st) != 0){
+        close(in);
+        return false;
+    }
+    //created with the same permissions as ofstream, the umask applies to both
+    int out = open(filePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(out < 0){
+        close(in);
+        return false;
+    }
+    bool copied = false;
+#ifdef FICLONE
+    copied = ioctl(out, FICLONE, in) == 0;
+#endif
+    off_t remaining = st.st_size;
+#ifdef __linux__
+    while(!copied && remaining > 0){
+        ssize_t n = copy_file_range(in, nullptr, out, nullptr, remaining, 0);
+        if(n <= 0){
+            break;
+        }
+        remaining -= n;
+    }
+#endif
+    if(!copied && remaining > 0){
+        lseek(in, st.st_size - remaining, SEEK_SET);
+        vector<char> buffer(1 << 16);
+        ssize_t n;
+        while(remaining > 0 && (n = read(in, buffer.data(), buffer.size())) > 0){
+            if(write(out, buffer.data(), n) != n){
+                break;
+            }
+            remaining -= n;
+        }
+    }
+    copied = copied || remaining == 0;
+    close(in);
+    close(out);
+    return copied;
+}
+
+/*writes the blob cache index to .mygit/cache/index after a checkout
+  the least recently used blobs are removed first if cache.maxSize was lowered*/
+void saveBlobCache(){
+    if(!blobCacheSettings().enabled || !exists(".mygit/cache")){
+        return;
+    }
+    BlobCacheIndex& index = blobCacheIndex();
+    while(index.totalSize > blobCacheSettings().maxSize && !index.byLastUse.empty()){
+        dropCachedBlob(index.byLastUse.begin()->second);
+    }
+    string tmpPath = ".mygit/cache/index.tmp" + to_string(getpid());
+    ofstream out(tmpPath, ios::trunc);
+    if(!out.is_open()){
+        cout << "Cannot write to cache index\n";
+        return;
+    }
+    for(const auto& [hash, blob]: index.blobs){
+        out << hash << " " << blob.size << " " << blob.mtime << " " << blob.lastUse << "\n";
+    }
+    out.close();
+    rename(tmpPath.c_str(), ".mygit/cache/index");
+    if(index.lockFd >= 0){
+        flock(index.lockFd, LOCK_UN);
+        close(index.lockFd);
+        index.lockFd = -1;
+    }
+}
+
+//returns the sparse checkout patterns, an empty list means the whole tree is checked out
+vector<string> readSparsePatterns(){
+    vector<string> patterns;
+    ifstream sparseFile(".mygit/sparse-checkout");
+    if(!sparseFile.is_open()){
+        return patterns;
+    }
+    string line;
+    while(getline(sparseFile, line)){
+        string pattern = normalizePath(line);
+        if(!pattern.empty()){
+            patterns.push_back(pattern);
+        }
+    }
+    return patterns;
+}
+
+/*sets, lists or disables the sparse checkout patterns stored in .mygit/sparse-checkout
+  each pattern is a file or directory path, the patterns are applied on the next checkout*/
+void sparseCheckout(const string& action, const vector<string>& patterns){
+    if(!exists(".mygit")){
+        cout << ".mygit does not exist\n";
+        exit(0);
+    }
+    if(action == "set"){
+        ofstream sparseFile(".mygit/sparse-checkout", ios::trunc);
+        if(!sparseFile.is_open()){
+            cout << "Cannot write to sparse-checkout file\n";
+            exit(0);
+        }
+        for(const string& pattern: patterns){
+            if(!normalizePath(pattern).empty()){
+                sparseFile << normalizePath(pattern) << "\n";
+            }
+        }
+        sparseFile.close();
+        cout << "Sparse checkout patterns updated\n";
+    }
+    else if(action == "list"){
+        for(const string& pattern: readSparsePatterns()){
+            cout << pattern << "\n";
+        }
+    }
+    else if(action == "disable"){
+        remove(".mygit/sparse-checkout");
+        cout << "Sparse checkout disabled\n";
+    }
+    else{
+        cout << "Wrong command format\n";
+    }
+}
+
+void prevState(const string& treeHash, const string& currPath, const vector<string>& patterns);
+
+//creates the file or directory for a tree entry, a directory is only filled with paths matching the patterns
+void materializeEntry(const TreeEntry& entry, const string& entryPath, const vector<string>& patterns){
+    if(entry.type == "blob"){
+        path parentPath = path(entryPath).parent_path();
+        if(!parentPath.empty() && !exists(parentPath)){
+            create_directories(parentPath);
+        }
+        string fileData;
+        bool inflated = false;
+        if(blobCacheSettings().enabled && checkoutCachedBlob(entry.hash, entryPath, fileData, inflated)){
+            return;
+        }
+        if(!inflated){
+            fileData = readObject(entry.hash);
+        }
+        ofstream out(entryPath);
+        out << fileData;
+        out.close();
+    }
+    else if(entry.type == "tree"){
+        create_directories(entryPath);
+        prevState(entry.hash, entryPath, patterns);
+    }
+}
+
 /*reads the tree contents from the hash value
   if it is a blob object, it creates the file using its hash value
-  if it is a tree, it creates the directory and recursively calls the function to create all the files inside it*/
-void prevState(const string& treeHash, const string& currPath){
+  if it is a tree, it creates the directory and recursively calls the function to create all the files inside it
+  if sparse patterns are given, each pattern is binary searched one level at a time
+  and subtrees not matching any pattern are never read*/
+void prevState(const string& treeHash, const string& currPath, const vector<string>& patterns){
     string treeData = readObject(treeHash);
-    istringstream treeStream(treeData);
-    string line;
-    while(getline(treeStream, line)){
-        istringstream lineStream(line);
-        string mode, type, hash, name;
-        lineStream >> mode >> type >> hash >> name;
-        if(type == "blob"){
-            string fileData = readObject(hash);
-            ofstream out(currPath + "/" + name);
-            out << fileData;
-            out.close();
+    if(patterns.empty()){
+        for(const TreeEntry& entry: parseTree(treeData)){
+            materializeEntry(entry, currPath + "/" + entry.name, patterns);
+        }
+        return;
+    }
+    //flat trees from older commits store the whole path as the name, so each entry is matched against the patterns
+    if(isFlatTree(treeData)){
+        for(const TreeEntry& entry: parseTree(treeData)){
+            for(const string& pattern: patterns){
+                if(entry.name == pattern || entry.name.compare(0, pattern.size() + 1, pattern + "/") == 0){
+                    materializeEntry(entry, currPath + "/" + entry.name, {});
+                    break;
+                }
+            }
+        }
+        return;
+    }
+    //groups the patterns by their first component, an empty remainder matches the whole entry
+    map<string, vector<string>> subPatterns;
+    for(const string& pattern: patterns){
+        size_t slash = pattern.find('/');
+        subPatterns[pattern.substr(0, slash)].push_back(slash == string::npos ? "" : pattern.substr(slash + 1));
+    }
+    for(const auto& [entryName, rest]: subPatterns){
+        TreeEntry entry;
+        if(!findTreeEntry(treeData, entryName, entry)){
+            continue;
+        }
+        if(find(rest.begin(), rest.end(), "") != rest.end()){
+            materializeEntry(entry, currPath + "/" + entryName, {});
+        }
+        else if(entry.type == "tree"){
+            materializeEntry(entry, currPath + "/" + entryName, rest);
+        }
+    }
+}
+
+//removes everything in the working directory except the .mygit folder
+void clearWorkingDirectory(){
+    for(const auto& entry : directory_iterator(".")){
+        if(entry.path().filename() != ".mygit"){
+            remove_all(entry.path());
         }
-        else if(type == "tree"){
-            create_directory(currPath + "/" + name);
-            prevState(hash, currPath + "/" + name);
+    }
+}
+
+/*restores tree entries over the working directory
+  only the paths present in the tree are overwritten, untracked files are left in place*/
+void restoreEntries(const vector<TreeEntry>& entries, const string& currPath){
+    for(const TreeEntry& entry: entries){
+        string entryPath = currPath + "/" + entry.name;
+        if(entry.type == "blob"){
+            if(is_directory(entryPath)){
+                remove_all(entryPath);
+            }
+            materializeEntry(entry, entryPath, {});
+        }
+        else if(entry.type == "tree"){
+            if(exists(entryPath) && !is_directory(entryPath)){
+                remove(entryPath);
+            }
+            create_directories(entryPath);
+            restoreEntries(readTree(entry.hash), entryPath);
         }
     }
 }
 
 /*reads the commit hash given as argument and retrives its tree hash
-  clears the entire working directory except the .mygit folder
-  updates the refs/heads/master to contain the new commit hash*/
-void checkout(const string& commitHash){
+  if paths are given, only those paths are restored from the commit and HEAD is left unchanged
+  otherwise, it clears the entire working directory except the .mygit folder,
+  checks out the paths matching the sparse checkout patterns
+  and updates the refs/heads/master to contain the new commit hash*/
+void checkout(const string& commitHash, const vector<string>& paths){
     string commitTree = readObject(commitHash);
     istringstream commitTreeData(commitTree);
     string line;
@@ -579,12 +1292,38 @@ void checkout(const string& commitHash){
         cout << "No previous commits\n";
         exit(0);
     }
-    for(const auto& entry : directory_iterator(".")){
-        if(entry.path().filename() != ".mygit"){
-            remove_all(entry.path());
+    //loading the cache index takes its lock before the working directory is touched
+    if(blobCacheSettings().enabled){
+        blobCacheIndex();
+    }
+    if(!paths.empty()){
+        for(const string& filePath: paths){
+            TreeEntry entry;
+            vector<TreeEntry> children;
+            string entryPath = normalizePath(filePath);
+            if(!lookupPath(treeHash, entryPath, entry, children)){
+                cout << "Path not found in commit: " << filePath << "\n";
+                continue;
+            }
+            //an empty path such as "." restores the whole tree
+            string target = entryPath.empty() ? "." : "./" + entryPath;
+            if(entry.type == "blob"){
+                restoreEntries({{entry.mode, entry.type, entry.hash, path(target).filename().string()}}, path(target).parent_path().string());
+            }
+            else{
+                if(exists(target) && !is_directory(target)){
+                    remove(target);
+                }
+                create_directories(target);
+                restoreEntries(children, target);
+            }
         }
+        saveBlobCache();
+        return;
     }
-    prevState(treeHash, ".");
+    clearWorkingDirectory();
+    prevState(treeHash, ".", readSparsePatterns());
+    saveBlobCache();
 
     ifstream headFile(".mygit/HEAD");
     if(headFile.is_open()){
@@ -610,6 +1349,7 @@ void checkout(const string& commitHash){
 int main(int argc, char* argv[]){
     bool store = false;
     bool name = false;
+    bool recursive = false;
     string cmd = argv[1];
     if(cmd == "init"){
         if(argc != 2){
@@ -639,16 +1379,27 @@ int main(int argc, char* argv[]){
         string treeHash = writeTree();
     }
     else if(cmd == "ls-tree"){
-        string isName = argv[2];
-        if(isName == "[--name-only]"){
-            name = true;
-            string hash = argv[3];
-            lsTree(hash, name);
+        string hash, filePath;
+        for(int i=2; i<argc; i++){
+            string arg = argv[i];
+            if(arg == "[--name-only]" || arg == "--name-only"){
+                name = true;
+            }
+            else if(arg == "[-r]" || arg == "-r"){
+                recursive = true;
+            }
+            else if(hash.empty()){
+                hash = arg;
+            }
+            else{
+                filePath = arg;
+            }
         }
-        else{
-            string hash = argv[2];
-            lsTree(hash, name);
+        if(hash.empty()){
+            cout << "Wrong command format\n";
+            exit(0);
         }
+        lsTree(hash, name, recursive, filePath);
     }
     else if(cmd == "add"){
         vector<string> files;
@@ -682,6 +1433,34 @@ int main(int argc, char* argv[]){
     }
     else if(cmd == "checkout"){
         string commitHash = argv[2];
-        checkout(commitHash);
+        vector<string> paths;
+        if(argc > 3){
+            if(string(argv[3]) != "--" || argc == 4){
+                cout << "Wrong command format\n";
+                exit(0);
+            }
+            for(int i=4; i<argc; i++){
+                paths.push_back(argv[i]);
+            }
+        }
+        checkout(commitHash, paths);
+    }
+    else if(cmd == "config"){
+        if(argc != 3 && argc != 4){
+            cout << "Wrong command format\n";
+            exit(0);
+        }
+        config(argv[2], argc == 4 ? argv[3] : "", argc == 4);
+    }
+    else if(cmd == "sparse-checkout"){
+        if(argc < 3){
+            cout << "Wrong command format\n";
+            exit(0);
+        }
+        vector<string> patterns;
+        for(int i=3; i<argc; i++){
+            patterns.push_back(argv[i]);
+        }
+        sparseCheckout(argv[2], patterns);
     }
 }
\ No newline at end of file